@@ -1,6 +1,7 @@
 #ifndef SERVER_H
 #	define SERVER_H
 
+#define _GNU_SOURCE                                 // sched_setaffinity() and CPU_SET()
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -11,10 +12,26 @@
 #include <signal.h> 
 #include <arpa/inet.h>
 #include <ctype.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include "shm_ring.h"
 
 #define MSG_SIZE        9                           // Size of client messages (1 byte type + 2×4 byte integers)
 #define RESPONSE_SIZE   4                           // Size of server response (4 byte integer)
 
+#define TIMER_TICK_MS   100                         // Timer wheel resolution
+#define WHEEL_L0_SLOTS  256                         // Level 0: one slot per tick (25.6 s)
+#define WHEEL_L1_SLOTS  64                          // Level 1: one slot per WHEEL_L0_SLOTS ticks (~27 min), longer timers are clamped
+
+#define CAPTURE_MAGIC   "PRICECAP"                  // First 8 bytes of a traffic capture file
+#define CAPTURE_RECORD  21                          // Capture record: 4 byte session id + 8 byte time (us) + 9 byte frame
+#define CAPTURE_END_FLAG (1ULL << 63)               // Set in the time field of the record written when a session closes
+
 /**
  * Structure representing a single price entry
  * Each entry contains a timestamp and corresponding price value
@@ -25,6 +42,18 @@ typedef struct {
 
 } price_entry_t;
 
+/**
+ * How a monitored file descriptor reaches the protocol logic
+ * Socket clients (TCP and AF_UNIX) are read with recv(); shared-memory sessions are indexed
+ * by their request doorbell and drained from the ring; the shm control connection only signals hang-up
+ */
+typedef enum {
+    TRANSPORT_SOCKET = 0,                           // TCP or AF_UNIX stream client
+    TRANSPORT_SHM,                                  // Request doorbell eventfd of a shared-memory session
+    TRANSPORT_SHM_CONTROL                           // AF_UNIX control connection of a shared-memory session
+
+} transport_t;
+
 /**
  * Structure representing a client's session data
  * Each connected client has their own isolated data storage
@@ -33,17 +62,99 @@ typedef struct {
     price_entry_t       *prices;                    // Dynamic array of price entries
     size_t              count;                      // Current number of stored prices
     size_t              capacity;                   // Maximum number of prices array can hold
+    uint32_t            session_id;                 // Unique id for traffic capture (fds get reused, ids do not)
+    transport_t         transport;                  // Which transport this fd belongs to
+    shm_region_t        *ring;                      // Shared rings (TRANSPORT_SHM only)
+    int                 doorbell;                   // Response doorbell eventfd (TRANSPORT_SHM only)
+    int                 peer;                       // Control fd for TRANSPORT_SHM, doorbell fd for TRANSPORT_SHM_CONTROL
+    bool                ring_pending;               // Responses pushed since the last doorbell write
+    char                frame[MSG_SIZE];            // Frame being reassembled from short recv()s (socket clients)
+    int                 frame_len;                  // Bytes of frame received so far
+    long long           last_active;                // Monotonic ms of the last frame (or of accept)
+    bool                shrunk;                     // prices already shrunk to fit since the last frame
+    bool                blocked;                    // Stalled by the memory budget: not read until memory is released
+    int32_t             parked_timestamp;           // Insert that did not fit, retried by resume_blocked()
+    int32_t             parked_price;
+    long long           timer_expires;              // Tick the idle timer fires at
+    int                 *timer_slot;                // Wheel list the idle timer is linked into, NULL when disarmed
+    int                 timer_next;                 // Next/previous fd in the same wheel slot (-1 = none)
+    int                 timer_prev;
 
 } client_data_t;
 
+/**
+ * Hierarchical timer wheel driving idle-session timers
+ * Timers are intrusive lists of session fds; a level 1 slot is cascaded into level 0
+ * every WHEEL_L0_SLOTS ticks, so adding, cancelling and firing a timer are all O(1)
+ */
+typedef struct {
+    long long           now_tick;                   // Last tick processed
+    int                 level0[WHEEL_L0_SLOTS];     // Head fd of each slot (-1 = empty)
+    int                 level1[WHEEL_L1_SLOTS];
+    int                 armed;                      // Number of armed timers
+    long long           next_tick;                  // Earliest tick with a timer due or a cascade to run (-1 = none)
+
+} timer_wheel_t;
+
+/**
+ * Resource limits, filled from the optional command line flags (0 = unlimited / disabled)
+ */
+typedef struct {
+    int                 idle_timeout_s;             // Close sessions with no frames for this long (-i)
+    int                 shrink_after_s;             // Shrink idle sessions' price arrays to fit after this long (-k)
+    int                 mem_budget_mb;              // Global budget for session memory in MiB (-M)
+
+} limits_config_t;
+
+/**
+ * Counters reported by print_stats() on SIGUSR1 and at shutdown
+ */
+typedef struct {
+    size_t              sessions_open;              // Sessions currently connected
+    size_t              sessions_reaped;            // Sessions closed by the idle timeout
+    size_t              sessions_shrunk;            // Shrink-to-fit operations on idle sessions
+    size_t              bytes_reclaimed;            // Bytes returned by shrink-to-fit
+    size_t              mem_used;                   // Session memory currently accounted (price arrays + shm rings)
+    size_t              connections_refused;        // Connections rejected because of the memory budget
+    size_t              sessions_blocked;           // Sessions currently stalled by the memory budget
+    size_t              inserts_refused;            // Inserts dropped because every open session was stalled (last resort)
+
+} server_stats_t;
+
+/**
+ * Opt-in low-latency settings, filled from the optional command line flags
+ * Every field defaults to "off" so a plain ./price_server <port> behaves as before
+ */
+typedef struct {
+    int                 cpu;                        // CPU to pin the event loop to (-1 = no pinning)
+    int                 spin_us;                    // Microseconds to spin-poll before blocking in select() (0 = block at once)
+    int                 busy_poll_us;               // SO_BUSY_POLL value for client sockets (0 = disabled)
+    bool                lock_memory;                // mlockall() and pre-fault session memory
+
+} lowlat_config_t;
+
 
 bool                    g_signal = false;           // Flag set by signal handler to trigger shutdown
 static int32_t          server, client, last;       // server: listening socket, client: current client, last: highest FD number
+static int32_t          unix_server = -1;           // AF_UNIX stream listener (-u), -1 when disabled
+static int32_t          shm_server = -1;            // AF_UNIX listener handing out shared-memory sessions (-m), -1 when disabled
+char                    *g_unix_path = NULL;        // Filesystem path of the AF_UNIX listener
+char                    *g_shm_path = NULL;         // Filesystem path of the shared-memory handshake listener
 static client_data_t    client_sessions[1024];      // Per-client data storage (indexed by file descriptor)
 static char             buff[MSG_SIZE];             // Buffer for incoming 9-byte messages
 fd_set                  requests, readtime;         // requests: master FD set, readtime: working copy for select()
-struct sockaddr_in      servaddr, cli;              // servaddr: server address, cli: client address
-socklen_t               len = sizeof(cli);          // Size of client address structure
+struct sockaddr_in      servaddr;                   // servaddr: server address
 ssize_t                 r;                          // Return value from recv() calls
+lowlat_config_t         g_lowlat = {-1, 0, 0, false}; // Low-latency mode settings (all disabled by default)
+FILE                    *g_capture = NULL;          // Traffic capture file (-r), NULL when not recording
+char                    *g_capture_path = NULL;     // Path given with -r
+long long               g_capture_start;            // Monotonic time (us) the capture started at
+uint32_t                g_next_session_id = 1;      // Next session id handed out at accept()
+bool                    g_dump_stats = false;       // Flag set by SIGUSR1 to print stats from the main loop
+long long               g_now_ms;                   // Monotonic ms, refreshed once per event loop iteration
+limits_config_t         g_limits = {0, 0, 0};       // Idle timeout, shrink delay and memory budget (all disabled by default)
+server_stats_t          g_stats;                    // Session, reaping and budget counters
+bool                    g_mem_released = false;     // Memory was given back since stalled sessions were last retried
+timer_wheel_t           g_wheel;                    // Idle timers, initialised by timer_init()
 
 #endif
\ No newline at end of file
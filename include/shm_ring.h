@@ -0,0 +1,51 @@
+#ifndef SHM_RING_H
+#	define SHM_RING_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ * Shared-memory transport for clients on the same host
+ *
+ * Handshake: the client connects to the server's AF_UNIX shm socket (-m <path>) and receives,
+ * via SCM_RIGHTS, three descriptors in this order: the memfd holding one shm_region_t,
+ * the request doorbell eventfd and the response doorbell eventfd.
+ * The control connection stays open for the lifetime of the session; closing it ends the session.
+ *
+ * Each ring is single-producer/single-consumer: the producer only writes head, the consumer only writes tail.
+ * Client: write frame into req, publish head, then write 1 to the request doorbell.
+ * Server: drain req, push answers into resp, then write 1 to the response doorbell.
+ * A client must not have more than SHM_RING_SLOTS queries outstanding - extra responses are dropped.
+ * A request head more than SHM_RING_SLOTS ahead of tail is a protocol violation and closes the session.
+ */
+
+#define SHM_RING_SLOTS      4096                    // Slots per ring (power of two)
+#define SHM_RING_MASK       (SHM_RING_SLOTS - 1)
+#define SHM_FRAME_SIZE      9                       // Same 9-byte frames as the socket protocol
+#define SHM_CACHE_LINE      64
+
+/**
+ * Head/tail pair of one ring, each on its own cache line so producer and consumer never false-share
+ * Indices increase forever and are masked on access; head - tail is the number of filled slots
+ */
+typedef struct {
+    _Alignas(SHM_CACHE_LINE) _Atomic uint32_t head; // Next slot the producer writes
+    char                pad_head[SHM_CACHE_LINE - sizeof(uint32_t)];
+    _Atomic uint32_t    tail;                       // Next slot the consumer reads
+    char                pad_tail[SHM_CACHE_LINE - sizeof(uint32_t)];
+
+} shm_ring_index_t;
+
+/**
+ * Layout of the shared memory region of one session
+ * Frames and responses are stored exactly as on the wire (network byte order)
+ */
+typedef struct {
+    shm_ring_index_t    req;                        // Client -> server frames
+    unsigned char       req_slots[SHM_RING_SLOTS][SHM_FRAME_SIZE];
+    shm_ring_index_t    resp;                       // Server -> client query answers
+    int32_t             resp_slots[SHM_RING_SLOTS];
+
+} shm_region_t;
+
+#endif
@@ -8,6 +8,19 @@ void sigHandler(int signum) {
 	if (signum == SIGINT || signum == SIGQUIT) {
 		g_signal = true;  								// Set flag to exit main loop
 	}
+	else if (signum == SIGUSR1) {
+		g_dump_stats = true;							// Printed by the main loop, not from signal context
+	}
+}
+
+/**
+ * Write a message to stderr without going through stdio buffering
+ * Used for both fatal errors and non-fatal warnings
+ */
+void puterror(const char *msg) {
+	for (size_t i = 0; msg[i] != '\0'; ++i) {			//	putstr but specified fd (stderr = 2)
+		write (2, &msg[i], 1);
+	}
 }
 
 /**
@@ -16,26 +29,206 @@ void sigHandler(int signum) {
  */
 void exiterror(const char *msg) {
 	if (server > 2) close(server);  					// Close server socket if it's open (fd > 2)
-	for (size_t i = 0; msg[i] != '\0'; ++i) {			//	putstr but specified fd (stderr = 2)
-		write (2, &msg[i], 1);
-	}
+	puterror(msg);
 	exit(1);
 }
 
+/**
+ * Monotonic clock in microseconds, used for the spin deadline and capture timestamps
+ */
+long long now_us(void) {
+	struct timespec	ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/**
+ * Append a record to the capture file
+ * Record layout (all big-endian): session id (4), microseconds since capture start (8), raw frame (9)
+ * flags is ORed into the time field (CAPTURE_END_FLAG), keeping markers out of the frame bytes clients control
+ * Writes go through a large stdio buffer so recording costs a memcpy per frame, not a syscall
+ */
+void capture_write(int fd, const char *frame, uint64_t flags) {
+	unsigned char	record[CAPTURE_RECORD];
+	uint32_t		id = htonl(client_sessions[fd].session_id);
+	uint64_t		elapsed = (now_us() - g_capture_start) | flags;
+
+	memcpy(record, &id, 4);
+	for (int i = 0; i < 8; ++i) {						// 64-bit big-endian timestamp
+		record[4 + i] = (unsigned char)(elapsed >> (56 - 8 * i));
+	}
+	memcpy(record + 12, frame, MSG_SIZE);
+	if (fwrite(record, CAPTURE_RECORD, 1, g_capture) != 1) {
+		puterror("Warning: capture write failed, recording stopped\n");
+		fclose(g_capture);
+		g_capture = NULL;
+	}
+}
+
+/**
+ * Record a frame received from a client
+ */
+void record_frame(int fd, const char *frame) {
+	capture_write(fd, frame, 0);
+}
+
+/**
+ * Record that a session closed, so the replay closes its connection at the same point
+ * The frame bytes of this record are zero and carry no meaning
+ */
+void record_session_end(int fd) {
+	static const char	no_frame[MSG_SIZE];
+
+	capture_write(fd, no_frame, CAPTURE_END_FLAG);
+}
+
+/**
+ * Open the capture file and write its header
+ * Called once at startup when -r <file> was given, after the listeners were created,
+ * so a bad port or a failed bind never truncates an existing capture
+ */
+void open_capture(const char *path) {
+	g_capture = fopen(path, "wb");
+	if (!g_capture) {
+		exiterror("Could not open capture file\n");
+	}
+	setvbuf(g_capture, NULL, _IOFBF, 1 << 16);
+	if (fwrite(CAPTURE_MAGIC, 8, 1, g_capture) != 1) {
+		exiterror("Could not write capture header\n");
+	}
+	g_capture_start = now_us();
+}
+
+/**
+ * Account for bytes of session memory against the global budget (-M)
+ * Returns: true if the bytes fit and were charged, false if they would exceed the budget
+ */
+bool mem_reserve(size_t bytes) {
+	if (g_limits.mem_budget_mb > 0 && g_stats.mem_used + bytes > (size_t)g_limits.mem_budget_mb << 20) {
+		return false;
+	}
+	g_stats.mem_used += bytes;
+	return true;
+}
+
+/**
+ * Give back bytes previously charged with mem_reserve()
+ */
+void mem_release(size_t bytes) {
+	g_stats.mem_used -= bytes;
+	g_mem_released = true;								// Stalled sessions get another try
+}
+
+/**
+ * Empty every wheel slot - must run before the first session is accepted
+ */
+void timer_init(long long now_ms) {
+	for (int i = 0; i < WHEEL_L0_SLOTS; ++i) g_wheel.level0[i] = -1;
+	for (int i = 0; i < WHEEL_L1_SLOTS; ++i) g_wheel.level1[i] = -1;
+	g_wheel.now_tick = now_ms / TIMER_TICK_MS;
+	g_wheel.armed = 0;
+	g_wheel.next_tick = -1;
+}
+
+/**
+ * Link fd's timer into the wheel slot matching its expiry tick
+ * Expiries in the past fire on the next tick; expiries beyond the last level are clamped
+ * (the timer callback re-checks the real deadline and re-arms)
+ */
+void timer_link(int fd) {
+	client_data_t	*session = &client_sessions[fd];
+	long long		expires = session->timer_expires;
+	long long		max_delta = (long long)WHEEL_L0_SLOTS * WHEEL_L1_SLOTS - 1;
+
+	if (expires <= g_wheel.now_tick) expires = g_wheel.now_tick + 1;
+	if (expires - g_wheel.now_tick > max_delta) expires = g_wheel.now_tick + max_delta;
+	session->timer_expires = expires;
+	long long		due = expires;						// Tick the wheel has work for this timer
+	if (expires - g_wheel.now_tick < WHEEL_L0_SLOTS) {
+		session->timer_slot = &g_wheel.level0[expires % WHEEL_L0_SLOTS];
+	}
+	else {
+		session->timer_slot = &g_wheel.level1[(expires / WHEEL_L0_SLOTS) % WHEEL_L1_SLOTS];
+		due = expires / WHEEL_L0_SLOTS * WHEEL_L0_SLOTS;	// Its cascade comes first
+	}
+	session->timer_prev = -1;							// Push at the head of the slot list
+	session->timer_next = *session->timer_slot;
+	if (session->timer_next >= 0) client_sessions[session->timer_next].timer_prev = fd;
+	*session->timer_slot = fd;
+	if (g_wheel.next_tick < 0 || due < g_wheel.next_tick) g_wheel.next_tick = due;
+}
+
+/**
+ * Unlink fd's timer from whatever slot it is in (no-op when not armed)
+ */
+void timer_unlink(int fd) {
+	client_data_t	*session = &client_sessions[fd];
+
+	if (!session->timer_slot) return;
+	if (session->timer_prev >= 0) client_sessions[session->timer_prev].timer_next = session->timer_next;
+	else *session->timer_slot = session->timer_next;
+	if (session->timer_next >= 0) client_sessions[session->timer_next].timer_prev = session->timer_prev;
+	session->timer_slot = NULL;
+}
+
+/**
+ * Cancel fd's idle timer, e.g. when the session closes
+ */
+void timer_cancel(int fd) {
+	if (client_sessions[fd].timer_slot) {
+		timer_unlink(fd);
+		--g_wheel.armed;
+	}
+}
+
+/**
+ * Arm fd's idle timer for the next thing that can happen to it: shrink-to-fit or reaping
+ * Activity never touches the wheel - it only moves last_active, and the timer re-arms itself when it fires
+ */
+void timer_arm_session(int fd) {
+	client_data_t	*session = &client_sessions[fd];
+	long long		deadline = -1;
+
+	if (g_limits.shrink_after_s > 0 && !session->shrunk) {
+		deadline = session->last_active + g_limits.shrink_after_s * 1000LL;
+	}
+	if (g_limits.idle_timeout_s > 0) {
+		long long	reap = session->last_active + g_limits.idle_timeout_s * 1000LL;
+		deadline = (deadline < 0 || reap < deadline) ? reap : deadline;
+	}
+	if (deadline < 0) return;							// Neither limit configured
+	session->timer_expires = (deadline + TIMER_TICK_MS - 1) / TIMER_TICK_MS;	// Round up: never fire early
+	timer_link(fd);
+	++g_wheel.armed;
+}
+
 /**
  * Initialize client session data when a new client connects
  * Allocates memory for price storage and sets initial values
- * Returns: 0 on success, -1 on memory allocation failure
+ * Returns: 0 on success, -1 on memory allocation failure or when the memory budget is exhausted
  */
 int init_client_data(int fd) {
+	if (!mem_reserve(sizeof(price_entry_t) * 100)) {	// Refuse new sessions before the box starts swapping
+		++g_stats.connections_refused;
+		return -1;
+	}
 	// Allocate initial memory for 100 price entries
 	client_sessions[fd].prices = malloc(sizeof(price_entry_t) * 100);
 	if (!client_sessions[fd].prices) {
+		mem_release(sizeof(price_entry_t) * 100);
 		return -1;
 	}
+	if (g_lowlat.lock_memory) {							// Touch every page now so the first inserts never page-fault
+		memset(client_sessions[fd].prices, 0, sizeof(price_entry_t) * 100);
+	}
 	// Initialize session state
 	client_sessions[fd].count = 0;       				// No prices stored yet
 	client_sessions[fd].capacity = 100;  				// Can hold 100 prices initially
+	client_sessions[fd].session_id = g_next_session_id++;
+	client_sessions[fd].last_active = g_now_ms;
+	client_sessions[fd].shrunk = false;
+	timer_arm_session(fd);								// No-op unless -i or -k was given
+	++g_stats.sessions_open;
 	return 0;  // Success
 }
 
@@ -45,31 +238,205 @@ int init_client_data(int fd) {
  */
 void cleanup_client_data(int fd) {
 	if (client_sessions[fd].prices) {
+		if (g_capture) record_session_end(fd);			// Let the replay close its connection here too
+		timer_cancel(fd);								// Only sessions with prices ever have a timer
+		if (client_sessions[fd].blocked) {				// Its parked insert goes away with it
+			client_sessions[fd].blocked = false;
+			--g_stats.sessions_blocked;
+		}
+		mem_release(sizeof(price_entry_t) * client_sessions[fd].capacity);
+		--g_stats.sessions_open;
 		free(client_sessions[fd].prices);     			// Free the price array
 		client_sessions[fd].prices = NULL;    			// Prevent double-free
 		client_sessions[fd].count = 0;        			// Reset count
 		client_sessions[fd].capacity = 0;     			// Reset capacity  
 	}
+	if (client_sessions[fd].ring) {
+		munmap(client_sessions[fd].ring, sizeof(shm_region_t));	// Unmap the shared rings
+		mem_release(sizeof(shm_region_t));
+		client_sessions[fd].ring = NULL;
+		close(client_sessions[fd].doorbell);			// Response doorbell is owned by the session
+	}
+	client_sessions[fd].transport = TRANSPORT_SOCKET;	// fd may be reused by any transport
+	client_sessions[fd].ring_pending = false;
+	client_sessions[fd].frame_len = 0;					// Drop a half-received frame
+}
+
+/**
+ * Close a client and everything attached to it
+ * A shared-memory session owns two monitored fds (doorbell and control connection),
+ * so closing either one tears down both
+ */
+void close_session(int fd) {
+	if (client_sessions[fd].transport == TRANSPORT_SHM_CONTROL) {
+		fd = client_sessions[fd].peer;					// Always tear down from the doorbell side
+	}
+	if (client_sessions[fd].transport == TRANSPORT_SHM) {
+		int	control = client_sessions[fd].peer;
+		cleanup_client_data(control);
+		FD_CLR(control, &requests);
+		close(control);
+	}
+	cleanup_client_data(fd);    						// Free client's price data
+	FD_CLR(fd, &requests);		      					// Remove from monitoring set
+	close(fd);
+}
+
+/**
+ * Give an idle session's unused price slots back to the allocator
+ * Returns: the number of bytes reclaimed
+ */
+size_t shrink_session(int fd) {
+	client_data_t	*session = &client_sessions[fd];
+	size_t			target = session->count > 0 ? session->count : 1;	// Keep capacity > 0 so doubling still works
+
+	session->shrunk = true;
+	if (target >= session->capacity) return 0;
+	price_entry_t	*shrunk = realloc(session->prices, sizeof(price_entry_t) * target);
+	if (!shrunk) return 0;								// Keep the bigger array, nothing lost
+	size_t			freed = sizeof(price_entry_t) * (session->capacity - target);
+	session->prices = shrunk;
+	session->capacity = target;
+	mem_release(freed);
+	return freed;
+}
+
+/**
+ * Idle timer callback: reap the session if it hit the idle timeout,
+ * otherwise shrink it if due and re-arm for the next deadline
+ * A timer that fires after new activity simply re-arms from the newer last_active
+ * A session stalled by the memory budget is waiting on us, not idle, so it is never reaped
+ */
+void session_timer_fired(int fd) {
+	client_data_t	*session = &client_sessions[fd];
+
+	--g_wheel.armed;
+	if (session->blocked) {
+		session->last_active = g_now_ms;
+	}
+	long long		idle = g_now_ms - session->last_active;
+	if (g_limits.idle_timeout_s > 0 && idle >= g_limits.idle_timeout_s * 1000LL) {
+		++g_stats.sessions_reaped;
+		close_session(fd);
+		return;
+	}
+	if (g_limits.shrink_after_s > 0 && !session->shrunk && idle >= g_limits.shrink_after_s * 1000LL) {
+		++g_stats.sessions_shrunk;
+		g_stats.bytes_reclaimed += shrink_session(fd);
+	}
+	timer_arm_session(fd);
+}
+
+/**
+ * Scan the wheel for the tick the event loop next has to wake up at
+ * That is the first occupied level 0 slot, or the level 1 cascade boundary that brings in the nearest timers
+ * Only runs once the cached next_tick has been processed, never on a plain wakeup
+ * Returns: the tick, or -1 when no timer is armed
+ */
+long long timer_find_next(void) {
+	long long	next = -1;
+
+	if (g_wheel.armed == 0) return -1;
+	for (long long tick = g_wheel.now_tick + 1; tick < g_wheel.now_tick + WHEEL_L0_SLOTS; ++tick) {
+		if (g_wheel.level0[tick % WHEEL_L0_SLOTS] >= 0) {
+			next = tick;
+			break;
+		}
+	}
+	long long	lap = (g_wheel.now_tick / WHEEL_L0_SLOTS + 1) * WHEEL_L0_SLOTS;	// Next cascade boundary
+	for (int i = 0; i < WHEEL_L1_SLOTS && (next < 0 || lap < next); ++i, lap += WHEEL_L0_SLOTS) {
+		if (g_wheel.level1[(lap / WHEEL_L0_SLOTS) % WHEEL_L1_SLOTS] >= 0) {
+			next = lap;
+			break;
+		}
+	}
+	return next;
+}
+
+/**
+ * Advance the wheel to now_ms, cascading level 1 and firing every expired level 0 timer
+ * Ticks before the cached next_tick hold no work and are skipped; each processed tick costs O(1)
+ * plus the timers that actually fire or cascade. Cancelled timers may leave next_tick early, which only
+ * costs one empty tick before the wheel is rescanned
+ */
+void timer_advance(long long now_ms) {
+	long long	target = now_ms / TIMER_TICK_MS;
+
+	if (g_wheel.armed == 0) {							// Nothing to fire - just jump ahead
+		g_wheel.now_tick = target;
+		g_wheel.next_tick = -1;
+		return;
+	}
+	while (g_wheel.now_tick < target) {
+		if (g_wheel.next_tick > g_wheel.now_tick + 1) {	// Nothing due before next_tick
+			g_wheel.now_tick = g_wheel.next_tick - 1 < target ? g_wheel.next_tick - 1 : target;
+			continue;
+		}
+		++g_wheel.now_tick;
+		if (g_wheel.now_tick % WHEEL_L0_SLOTS == 0) {	// Start of a level 0 lap: spread the matching level 1 slot
+			int	*slot = &g_wheel.level1[(g_wheel.now_tick / WHEEL_L0_SLOTS) % WHEEL_L1_SLOTS];
+			while (*slot >= 0) {
+				int	fd = *slot;
+				timer_unlink(fd);
+				timer_link(fd);
+			}
+		}
+		int	*slot = &g_wheel.level0[g_wheel.now_tick % WHEEL_L0_SLOTS];
+		while (*slot >= 0) {
+			int	fd = *slot;
+			timer_unlink(fd);
+			session_timer_fired(fd);					// May close the session or re-arm it in a later slot
+		}
+		if (g_wheel.next_tick <= g_wheel.now_tick) {	// Cached tick processed - find the next one
+			g_wheel.next_tick = timer_find_next();
+		}
+	}
+}
+
+/**
+ * Print the session, reaping and memory budget counters to stdout
+ * Triggered by SIGUSR1 (kill -USR1 <pid>) and at shutdown
+ */
+void print_stats(void) {
+	char	line[512];
+	int		n = snprintf(line, sizeof(line),
+		"sessions: open=%zu reaped=%zu shrunk=%zu reclaimed=%zu bytes | "
+		"memory: used=%zu budget=%zu blocked=%zu | refused: connections=%zu inserts=%zu\n",
+		g_stats.sessions_open, g_stats.sessions_reaped, g_stats.sessions_shrunk, g_stats.bytes_reclaimed,
+		g_stats.mem_used, (size_t)g_limits.mem_budget_mb << 20, g_stats.sessions_blocked,
+		g_stats.connections_refused, g_stats.inserts_refused);
+	if (write(1, line, n) < 0) {
+		puterror("Warning: could not write stats\n");
+	}
 }
 
 /**
  * Insert a price entry for a client, maintaining chronological order
  * Handles dynamic memory allocation if more space is needed
  * Prices are kept sorted by timestamp for efficient querying
+ * Returns: false if growing the array would exceed the memory budget (nothing inserted), true otherwise
  */
-void insert_price(int fd, int32_t timestamp, int32_t price) {
+bool insert_price(int fd, int32_t timestamp, int32_t price) {
 	int				i;
 	client_data_t	*session;
 	session = &client_sessions[fd];  					// Get client's session data
 	
 	if (session->count >= session->capacity) {			// Check if more memory is needed (array is full)
-		session->capacity *= 2;  						// Double the capacity
+		size_t	grow = session->capacity;				// Doubling adds as many slots as we already have
+		if (!mem_reserve(sizeof(price_entry_t) * grow)) {
+			return false;								// Over the memory budget - caller stalls the session
+		}
 		// Reallocate memory for more price entries
-		price_entry_t *new_prices = realloc(session->prices, sizeof(price_entry_t) * session->capacity);
+		price_entry_t *new_prices = realloc(session->prices, sizeof(price_entry_t) * (session->capacity + grow));
 		if (!new_prices) {
-			return; 									// Memory allocation failed - keep old array intact, don't add this price
+			mem_release(sizeof(price_entry_t) * grow);
+			return true; 								// Memory allocation failed - keep old array intact, don't add this price
 		}
+		session->capacity += grow;  					// Double the capacity only once the memory is there
 		session->prices = new_prices;  					// Update pointer to new memory - realloc frees the old data
+		if (g_lowlat.lock_memory) {						// Pre-fault the freshly grown half of the array
+			memset(session->prices + session->count, 0, sizeof(price_entry_t) * (session->capacity - session->count));
+		}
 	}
 	
 	// Find correct position to insert (maintain chronological order) - start from the end && shift entries right
@@ -79,6 +446,51 @@ void insert_price(int fd, int32_t timestamp, int32_t price) {
 	session->prices[i].timestamp = timestamp; 			// Insert the new price entry at position i
 	session->prices[i].price = price;
 	session->count++;
+	return true;
+}
+
+/**
+ * Stall a session whose insert does not fit in the memory budget
+ * The insert is parked and the fd leaves the select() set: a socket client then backs up in TCP flow control,
+ * a shared-memory client fills its request ring. resume_blocked() picks it up once memory is released
+ */
+void block_session(int fd, int32_t timestamp, int32_t price) {
+	client_data_t	*session = &client_sessions[fd];
+
+	session->blocked = true;
+	session->parked_timestamp = timestamp;
+	session->parked_price = price;
+	++g_stats.sessions_blocked;
+	FD_CLR(fd, &requests);
+}
+
+/**
+ * Retry the parked insert of every stalled session and put the ones that fit back into the select() set
+ * Runs once memory was released. When every open session is stalled nothing can release memory any more,
+ * so as a last resort the parked inserts are dropped (counted in inserts_refused) and the sessions resumed
+ */
+void resume_blocked(void) {
+	bool	deadlock = g_stats.sessions_blocked == g_stats.sessions_open;
+
+	if (!g_mem_released && !deadlock) return;
+	g_mem_released = false;
+	for (int fd = 3; fd <= last && g_stats.sessions_blocked > 0; ++fd) {
+		client_data_t	*session = &client_sessions[fd];
+		if (!session->blocked) continue;
+		if (!insert_price(fd, session->parked_timestamp, session->parked_price)) {
+			if (!deadlock) continue;					// Still no room - stay stalled
+			++g_stats.inserts_refused;
+		}
+		session->blocked = false;
+		--g_stats.sessions_blocked;
+		FD_SET(fd, &requests);
+		if (session->transport == TRANSPORT_SHM) {		// Its doorbell was consumed - ring it so the ring is drained again
+			uint64_t	one = 1;
+			if (write(fd, &one, sizeof(one)) < 0) {
+				puterror("Warning: request doorbell write failed\n");
+			}
+		}
+	}
 }
 
 /**
@@ -106,6 +518,29 @@ int32_t query_average_price(int fd, int32_t mintime, int32_t maxtime) {
 	return (int32_t)(sum / count);						// Calculate and return average (integer division, truncates decimals)
 }
 
+/**
+ * Deliver a 4-byte query answer (already in network byte order) to the client
+ * Socket clients get it with send(); shared-memory clients get it pushed to their response ring,
+ * and the doorbell is rung once per drained batch by drain_ring()
+ */
+void send_response(int fd, int32_t response) {
+	client_data_t	*session = &client_sessions[fd];
+
+	if (session->transport != TRANSPORT_SHM) {
+		send(fd, &response, RESPONSE_SIZE, MSG_NOSIGNAL);	// MSG_NOSIGNAL: a vanished peer must not kill the server
+		return;
+	}
+	shm_ring_index_t	*idx = &session->ring->resp;
+	uint32_t			head = atomic_load_explicit(&idx->head, memory_order_relaxed);	// Only we write head
+	uint32_t			tail = atomic_load_explicit(&idx->tail, memory_order_acquire);
+	if (head - tail >= SHM_RING_SLOTS) {
+		return;											// Client has too many queries outstanding - drop (its own UB)
+	}
+	session->ring->resp_slots[head & SHM_RING_MASK] = response;
+	atomic_store_explicit(&idx->head, head + 1, memory_order_release);
+	session->ring_pending = true;
+}
+
 /**
  * Process a complete 9-byte message from a client
  * Parses the binary message and performs the requested operation (Insert or Query)
@@ -116,13 +551,21 @@ void handle_message(int fd) {
 	int32_t	first_int = ntohl(*(int32_t*)(buff + 1)); 		// Bytes 1-4: first integer
 	int32_t	second_int = ntohl(*(int32_t*)(buff + 5));		// Bytes 5-8: second integer
 	
-	if (msg_type == 'I') {
-		insert_price(fd, first_int, second_int);			// Insert operation: first_int = timestamp, second_int = price
+	client_sessions[fd].last_active = g_now_ms;				// Idle timer picks this up lazily when it fires
+	if (client_sessions[fd].shrunk) {						// Shrink deadline is armed again only after activity
+		client_sessions[fd].shrunk = false;
+		timer_cancel(fd);
+		timer_arm_session(fd);
+	}
+	if (msg_type == 'I') {									// Insert operation: first_int = timestamp, second_int = price
+		if (!insert_price(fd, first_int, second_int)) {
+			block_session(fd, first_int, second_int);		// Over the memory budget - push back on the client
+		}
 	}
 	else if (msg_type == 'Q') {								// Query operation: first_int = mintime, second_int = maxtime
 		int32_t average = query_average_price(fd, first_int, second_int);
 		int32_t response = htonl(average);  				// Convert to network byte order
-		send(fd, &response, RESPONSE_SIZE, 0);				// Send 4-byte response back to client
+		send_response(fd, response);						// Send 4-byte response back to client
 	}														// Invalid message types are ignored (undefined behavior allowed per spec)
 }
 
@@ -145,6 +588,143 @@ int	checkPort(char *av) {
 	return (port);
 }
 
+/**
+ * Checks that a string is a non-negative decimal number
+ * Returns the value, or -1 if the string is empty, has non-digits or is too large
+ */
+int	checkNumber(char *av) {
+	if (!av || av[0] == '\0' || strlen(av) > 9) {
+		return -1;
+	}
+	for (size_t i = 0; i < strlen(av); ++i) {
+		if (!isdigit(av[i])) {
+			return -1;
+		}
+	}
+	return (atoi(av));
+}
+
+/**
+ * Parse the optional flags that follow the port number
+ * -c <cpu>   pin the event loop to a CPU
+ * -s <us>    spin-poll for <us> microseconds before blocking in select()
+ * -b <us>    set SO_BUSY_POLL on client sockets (needs the net.core.busy_poll sysctl, see setup_lowlat_socket)
+ * -l         mlockall() and pre-fault session memory
+ * -r <file>  record every complete incoming frame to a capture file
+ * -u <path>  also listen on an AF_UNIX stream socket
+ * -m <path>  also hand out shared-memory ring sessions through an AF_UNIX socket
+ * -i <s>     close sessions that sent nothing for <s> seconds
+ * -k <s>     shrink idle sessions' price arrays to fit after <s> seconds
+ * -M <MiB>   global budget for session memory: refuse connections and inserts beyond it
+ */
+void parse_options(int ac, char **av) {
+	for (int i = 2; i < ac; ++i) {
+		if (strcmp(av[i], "-l") == 0) {
+			g_lowlat.lock_memory = true;
+			continue;
+		}
+		if (strcmp(av[i], "-r") == 0 || strcmp(av[i], "-u") == 0 || strcmp(av[i], "-m") == 0) {
+			if (i + 1 >= ac) {
+				exiterror("Flags -r, -u and -m expect a path\n");
+			}
+			if (av[i][1] == 'r') g_capture_path = av[i + 1];	// Opened only once every listener is up
+			else if (av[i][1] == 'u') g_unix_path = av[i + 1];
+			else g_shm_path = av[i + 1];
+			++i;
+			continue;
+		}
+		int	*target = NULL;
+		if (strcmp(av[i], "-c") == 0) target = &g_lowlat.cpu;
+		else if (strcmp(av[i], "-s") == 0) target = &g_lowlat.spin_us;
+		else if (strcmp(av[i], "-b") == 0) target = &g_lowlat.busy_poll_us;
+		else if (strcmp(av[i], "-i") == 0) target = &g_limits.idle_timeout_s;
+		else if (strcmp(av[i], "-k") == 0) target = &g_limits.shrink_after_s;
+		else if (strcmp(av[i], "-M") == 0) target = &g_limits.mem_budget_mb;
+		else {
+			exiterror("Unknown flag (expected -c, -s, -b, -i, -k, -M <number>, -l, or -r, -u, -m <path>)\n");
+		}
+		if (i + 1 >= ac || checkNumber(av[i + 1]) < 0) {
+			exiterror("Flags -c, -s, -b, -i, -k and -M expect a non-negative number\n");
+		}
+		*target = checkNumber(av[++i]);
+	}
+}
+
+/**
+ * Apply the process-wide part of low-latency mode
+ * Pins the event loop thread to the configured CPU and locks all memory in RAM
+ * Failures are reported but not fatal - the server still works, just with more jitter
+ */
+void setup_lowlat(void) {
+	if (g_lowlat.cpu >= 0) {
+		cpu_set_t	set;
+		CPU_ZERO(&set);
+		CPU_SET(g_lowlat.cpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set) != 0) {	// 0 = calling thread, which runs main_loop()
+			puterror("Warning: could not pin event loop to requested CPU\n");
+		}
+	}
+	if (g_lowlat.busy_poll_us > 0) {						// -b is inert unless select() itself busy-polls
+		FILE	*sysctl = fopen("/proc/sys/net/core/busy_poll", "r");
+		int		busy_poll = 0;
+		if (!sysctl || fscanf(sysctl, "%d", &busy_poll) != 1 || busy_poll <= 0) {
+			puterror("Warning: -b has no effect while net.core.busy_poll is 0 (sysctl -w net.core.busy_poll=50)\n");
+		}
+		if (sysctl) fclose(sysctl);
+	}
+	if (g_lowlat.lock_memory) {
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {		// Needs CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK
+			puterror("Warning: mlockall failed, session memory may be paged out\n");
+		}
+	}
+}
+
+/**
+ * Apply the per-socket part of low-latency mode to a freshly accepted client
+ * SO_BUSY_POLL only shortens blocking reads by itself, and we only recv() once select() says the
+ * socket is readable. What it does here is mark the socket as busy-pollable, so that select()
+ * polls the NIC queue instead of sleeping - which the kernel only does when the net.core.busy_poll
+ * sysctl is non-zero (checked once in setup_lowlat()). Loopback and AF_UNIX clients are unaffected.
+ */
+void setup_lowlat_socket(int fd) {
+	if (g_lowlat.busy_poll_us <= 0) {
+		return;
+	}
+	int	value = g_lowlat.busy_poll_us;
+	setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value));		// Best effort: may need CAP_NET_ADMIN
+}
+
+/**
+ * Wait until at least one monitored file descriptor is readable
+ * In low-latency mode, first polls select() with a zero timeout for spin_us microseconds
+ * so a message arriving shortly after the previous one avoids the scheduler wakeup
+ * While idle timers are armed, blocking is capped at the nearest timer deadline (g_wheel.next_tick)
+ * Returns: select() result, with readtime holding the ready descriptors (0 on timeout)
+ */
+int wait_for_events(void) {
+	int	ready;
+
+	if (g_lowlat.spin_us > 0) {
+		long long	deadline = now_us() + g_lowlat.spin_us;
+		do {
+			struct timeval	zero = {0, 0};
+			readtime = requests;
+			ready = select(last + 1, &readtime, NULL, NULL, &zero);
+			if (ready != 0) {
+				return ready;							// Either something is ready or select() failed
+			}
+		} while (!g_signal && now_us() < deadline);
+	}
+	readtime = requests; 								// Copy the file descriptor set (select() modifies it)
+	if (g_wheel.armed == 0 || g_wheel.next_tick < 0) {
+		return select(last + 1, &readtime, NULL, NULL, NULL);
+	}
+	long long		next_tick_ms = g_wheel.next_tick * TIMER_TICK_MS - now_us() / 1000;
+	if (next_tick_ms < 0) next_tick_ms = 0;
+	struct timeval	timeout = {next_tick_ms / 1000, (next_tick_ms % 1000) * 1000};
+	return select(last + 1, &readtime, NULL, NULL, &timeout);
+}
+
 /**
  * Create and configure the TCP server socket
  * Sets up socket address, binds to port, and starts listening for connections
@@ -177,46 +757,265 @@ void server_create(char **av) {
 	last = server;                							// Track highest file descriptor number
 }
 
+/**
+ * Remove a stale socket file left at the listener path by a previous run
+ * Anything that is not a socket, or a socket some live server still accepts on, is left alone
+ */
+void unix_path_reclaim(const struct sockaddr_un *addr) {
+	struct stat	st;
+
+	if (lstat(addr->sun_path, &st) != 0) {
+		return;											// Nothing there (bind reports other errors)
+	}
+	if (!S_ISSOCK(st.st_mode)) {
+		exiterror("AF_UNIX path exists and is not a socket\n");
+	}
+	int	probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (probe < 0) {
+		exiterror("AF_UNIX socket creation failed\n");
+	}
+	int	alive = connect(probe, (const struct sockaddr *)addr, sizeof(*addr)) == 0;
+	close(probe);
+	if (alive) {
+		exiterror("AF_UNIX path is in use by a running server\n");
+	}
+	unlink(addr->sun_path);
+}
+
+/**
+ * Create an AF_UNIX stream listener at path and add it to the select() set
+ * A stale socket file from a previous run is removed first, see unix_path_reclaim
+ * Returns: the listening fd
+ */
+int unix_listener_create(const char *path) {
+	struct sockaddr_un	addr;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		exiterror("AF_UNIX socket path too long\n");
+	}
+	bzero(&addr, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	int	listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0) {
+		exiterror("AF_UNIX socket creation failed\n");
+	}
+	unix_path_reclaim(&addr);
+	if (bind(listener, (const struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		exiterror("AF_UNIX bind failed\n");
+	}
+	if (listen(listener, 10) != 0) {
+		exiterror("AF_UNIX listen failed\n");
+	}
+	FD_SET(listener, &requests);
+	last = last > listener ? last : listener;
+	return listener;
+}
+
+/**
+ * Accept a stream client (TCP or AF_UNIX) and give it a fresh session
+ * Connections that cannot be tracked are closed immediately
+ */
+void accept_client(int listener) {
+	client = accept(listener, NULL, NULL);
+	if (client < 0) {
+		exiterror(" Accept failed - critical error\n");
+	}
+	// Ensure client FD doesn't exceed our array size && initialize client session data
+	if (client >= 1024 || init_client_data(client) != 0) {
+		close(client);  								// Cannot handle this client - reject connection
+		return;
+	}
+	setup_lowlat_socket(client);						// No-op unless busy polling was requested
+	FD_SET(client, &requests); 							// Add new client to monitoring set
+	last = last > client ? last : client;				// Update highest file descriptor number for select()
+}
+
+/**
+ * Accept a shared-memory client on the handshake socket
+ * Creates the ring region (memfd) and two eventfd doorbells, passes all three with SCM_RIGHTS
+ * and registers the request doorbell as the session fd and the connection as its control fd
+ */
+void accept_shm_client(void) {
+	int	control = accept(shm_server, NULL, NULL);
+	if (control < 0) {
+		exiterror(" Accept failed - critical error\n");
+	}
+	int				memfd = memfd_create("price_server_ring", MFD_CLOEXEC);
+	int				req_bell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);	// We drain it from select()
+	int				resp_bell = eventfd(0, EFD_CLOEXEC);				// Client may block on it
+	shm_region_t	*ring = MAP_FAILED;
+
+	if (memfd >= 0 && ftruncate(memfd, sizeof(shm_region_t)) == 0) {
+		ring = mmap(NULL, sizeof(shm_region_t), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+	}
+	if (ring == MAP_FAILED || req_bell < 0 || resp_bell < 0 || control >= 1024 || req_bell >= 1024) {
+		goto reject;
+	}
+	if (!mem_reserve(sizeof(shm_region_t))) {			// The rings count against the budget too
+		++g_stats.connections_refused;
+		goto reject;
+	}
+	if (init_client_data(req_bell) != 0) {
+		mem_release(sizeof(shm_region_t));
+		goto reject;
+	}
+
+	// One byte of payload carries the three descriptors
+	int				fds[3] = {memfd, req_bell, resp_bell};
+	char			byte = 'M';
+	struct iovec	iov = {&byte, 1};
+	char			control_buf[CMSG_SPACE(sizeof(fds))];
+	struct msghdr	msg;
+	bzero(&msg, sizeof(msg));
+	bzero(control_buf, sizeof(control_buf));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control_buf;
+	msg.msg_controllen = sizeof(control_buf);
+	struct cmsghdr	*cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	if (sendmsg(control, &msg, MSG_NOSIGNAL) != 1) {
+		cleanup_client_data(req_bell);
+		mem_release(sizeof(shm_region_t));
+		goto reject;
+	}
+	close(memfd);										// The mapping keeps the region alive
+
+	client_sessions[req_bell].transport = TRANSPORT_SHM;
+	client_sessions[req_bell].ring = ring;
+	client_sessions[req_bell].doorbell = resp_bell;
+	client_sessions[req_bell].peer = control;
+	client_sessions[control].transport = TRANSPORT_SHM_CONTROL;
+	client_sessions[control].peer = req_bell;
+	FD_SET(req_bell, &requests);
+	FD_SET(control, &requests);
+	last = last > req_bell ? last : req_bell;
+	last = last > control ? last : control;
+	return;
+
+reject:
+	if (ring != MAP_FAILED) munmap(ring, sizeof(shm_region_t));
+	if (memfd >= 0) close(memfd);
+	if (req_bell >= 0) close(req_bell);
+	if (resp_bell >= 0) close(resp_bell);
+	close(control);
+}
+
+/**
+ * Process the frames waiting in a shared-memory session's request ring
+ * The doorbell is reset before draining, so a frame published after the drain always rings it again
+ * head is written by the client and cannot be trusted: an index more than a ring ahead of tail
+ * is a protocol violation and closes the session. At most SHM_RING_SLOTS frames are handled per call
+ * so a fast producer cannot starve other sessions; leftovers re-ring our own doorbell
+ */
+void drain_ring(int fd) {
+	client_data_t		*session = &client_sessions[fd];
+	shm_ring_index_t	*idx = &session->ring->req;
+	uint64_t			count;
+	int					budget = SHM_RING_SLOTS;
+
+	if (read(fd, &count, sizeof(count)) < 0) {			// Reset the eventfd counter (EAGAIN is harmless)
+		count = 0;
+	}
+	uint32_t	tail = atomic_load_explicit(&idx->tail, memory_order_relaxed);	// Only we write tail
+	uint32_t	head = atomic_load_explicit(&idx->head, memory_order_acquire);
+	while (tail != head && budget > 0) {
+		if (head - tail > SHM_RING_SLOTS) {				// Garbage head - refuse to walk billions of bogus slots
+			close_session(fd);
+			return;
+		}
+		memcpy(buff, session->ring->req_slots[tail & SHM_RING_MASK], MSG_SIZE);
+		++tail;
+		--budget;
+		atomic_store_explicit(&idx->tail, tail, memory_order_release);		// Free the slot before handling
+		if (g_capture) record_frame(fd, buff);
+		handle_message(fd);
+		if (session->blocked) break;					// Stalled by the memory budget - leave the rest in the ring
+		if (tail == head) {								// Pick up frames published while we were busy
+			head = atomic_load_explicit(&idx->head, memory_order_acquire);
+		}
+	}
+	if (session->ring_pending) {						// One doorbell per batch, not per response
+		uint64_t	one = 1;
+		session->ring_pending = false;
+		if (write(session->doorbell, &one, sizeof(one)) < 0) {
+			puterror("Warning: response doorbell write failed\n");
+		}
+	}
+	if (tail != head && !session->blocked) {			// Budget used up: come back after the other sessions
+		uint64_t	one = 1;
+		if (write(fd, &one, sizeof(one)) < 0) {
+			puterror("Warning: request doorbell write failed\n");
+		}
+	}
+}
+
 /**
  * Main server event loop - handles client connections and messages
  * Uses select() for non-blocking I/O to handle multiple clients simultaneously
  * Continues until a signal (SIGINT/SIGQUIT) is received
  */
 void main_loop() {
+	g_now_ms = now_us() / 1000;
+	timer_init(g_now_ms);
 	while (!g_signal) {
-		readtime = requests; 								// Copy the file descriptor set (select() modifies it)
-		if (select(last + 1, &readtime, NULL, NULL, NULL) < 0) {
+		g_now_ms = now_us() / 1000;
+		timer_advance(g_now_ms);							// Reap / shrink idle sessions before waiting again
+		if (g_stats.sessions_blocked > 0) {					// Resume sessions stalled by the memory budget
+			resume_blocked();
+		}
+		if (g_dump_stats) {
+			g_dump_stats = false;
+			print_stats();
+		}
+		if (wait_for_events() <= 0) {						// Error, signal or timer tick
 			continue;
 		}
+		g_now_ms = now_us() / 1000;							// Activity timestamps for this batch
 		if (FD_ISSET(server, &readtime)) { 					// Check if the server socket has a new connection waiting
-			client = accept(server, (struct sockaddr *)&cli, &len);
-			if (client < 0) {
-				exiterror(" Accept failed - critical error\n");
-			}
-			// Ensure client FD doesn't exceed our array size && initialize client session data
-			if (client >= 1024 || init_client_data(client) != 0) {
-				close(client);  							// Cannot handle this client - reject connection
-				continue;       							// Skip to next iteration
-			}
-			FD_SET(client, &requests); 						// Add new client to monitoring set
-			last = last > client ? last : client;			// Update highest file descriptor number for select()
+			accept_client(server);
 			continue;  										// Process this new connection on next iteration
 		}
+		if (unix_server >= 0 && FD_ISSET(unix_server, &readtime)) {
+			accept_client(unix_server);						// AF_UNIX clients are plain socket sessions from here on
+			continue;
+		}
+		if (shm_server >= 0 && FD_ISSET(shm_server, &readtime)) {
+			accept_shm_client();
+			continue;
+		}
 		for (int fd = 3; fd <= last; ++fd) {				// Check all possible client file descriptors for incoming data
 			if (!FD_ISSET(fd, &readtime)) continue; 		// Skip if this FD doesn't have data ready
-			bzero(buff, MSG_SIZE);							// Clear buffer before receiving new data
-			r = recv(fd, buff, MSG_SIZE, 0);				// Try to receive exactly MSG_SIZE (9) bytes from client
+			if (!FD_ISSET(fd, &requests)) continue;			// Closed earlier in this pass (e.g. with its shm control fd)
+			if (client_sessions[fd].transport == TRANSPORT_SHM) {
+				drain_ring(fd);
+				continue;
+			}
+			client_data_t	*session = &client_sessions[fd];
+			r = recv(fd, session->frame + session->frame_len, MSG_SIZE - session->frame_len, 0);	// Rest of the current frame
 			if (r <= 0) {									// Handle client disconnection or error
-				cleanup_client_data(fd);    				// Free client's price data
-				FD_CLR(fd, &requests);		      			// Remove from monitoring set
-				close(fd);
+				close_session(fd);
+			}
+			else if (session->transport == TRANSPORT_SHM_CONTROL) {
+				continue;									// Control connection carries no frames - ignore chatter
+			}
+			else if ((session->frame_len += r) == MSG_SIZE) {	// Handle complete message received
+				memcpy(buff, session->frame, MSG_SIZE);
+				session->frame_len = 0;
+				if (g_capture) record_frame(fd, buff);		// Record before handling so the capture mirrors arrival order
+				handle_message(fd);							// Got all 9 bytes - process the complete message
 			}
-			else if (r == MSG_SIZE) {						// Handle complete message received
-				handle_message(fd);							// Got exactly 9 bytes - process the complete message
-			}	
-		}													// Partial messages (r > 0 && r < MSG_SIZE) are ignored - acceptable per the protocol specification
+		}													// A frame split across TCP segments is completed by a later recv()
 	}														// Individual client cleanup happens automatically when process exits
 	close(server); 											// Close server socket to stop accepting new connections
+	if (unix_server >= 0) { close(unix_server); unlink(g_unix_path); }	// Remove the socket files we created
+	if (shm_server >= 0) { close(shm_server); unlink(g_shm_path); }
+	print_stats();											// Final counters
+	if (g_capture) fclose(g_capture);						// Flush buffered capture records
 }
 
 /**
@@ -224,12 +1023,18 @@ void main_loop() {
  * Validates command line arguments, sets up signal handling, creates server, and starts main loop
  */
 int main(int ac, char **av) {
-	if (ac != 2) {
-		exiterror("Expected usage: ./price_server <port_number>\n");
+	if (ac < 2) {
+		exiterror("Expected usage: ./price_server <port_number> [-c cpu] [-s spin_us] [-b busy_poll_us] [-l] [-r capture_file] [-u unix_path] [-m shm_path] [-i idle_s] [-k shrink_s] [-M budget_mib]\n");
 	}
+	parse_options(ac, av);									// Optional low-latency, capture, local transport and limit flags
 	signal(SIGINT, sigHandler);   							// Set up signal handlers for graceful shutdown
 	signal(SIGQUIT, sigHandler);
+	signal(SIGUSR1, sigHandler);							// kill -USR1 <pid> prints stats
 	server_create(av);										// Create and configure the TCP server socket
+	if (g_unix_path) unix_server = unix_listener_create(g_unix_path);	// Optional local transports
+	if (g_shm_path) shm_server = unix_listener_create(g_shm_path);
+	if (g_capture_path) open_capture(g_capture_path);
+	setup_lowlat();											// Pin and lock memory before serving the first client
 	main_loop();											// Start the main event loop
 	return (0);
 }
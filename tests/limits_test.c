@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+// Server flags this test is written against: ./price_server <port> -i 3 -k 1 -M 2
+#define IDLE_TIMEOUT_S  3
+#define SHRINK_AFTER_S  1
+#define BUDGET_BYTES    (2 << 20)
+#define MAX_FILLERS     200         // Connections opened while looking for a refused one
+#define SYNC_TIMEOUT_MS 10000       // Answers queued behind a few hundred thousand inserts
+
+const char *g_ip;
+int g_port;
+
+int connect_server(void) {
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        perror("Socket creation failed");
+        return -1;
+    }
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(g_port);
+    inet_pton(AF_INET, g_ip, &server_addr.sin_addr);
+    if (connect(sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        perror("Connection failed");
+        close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+// Bound every recv() so a stalled or closed session shows up as a result instead of a hang
+void set_timeout(int sockfd, int timeout_ms) {
+    struct timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+void pack_frame(char *message, char type, int32_t first, int32_t second) {
+    message[0] = type;
+    *(int32_t*)(message + 1) = htonl(first);
+    *(int32_t*)(message + 5) = htonl(second);
+}
+
+// Insert timestamps from..to with price == timestamp, one frame per send() like the other test clients
+int send_inserts(int sockfd, int32_t from, int32_t to) {
+    char message[9];
+    for (int32_t t = from; t <= to; ++t) {
+        pack_frame(message, 'I', t, t);
+        if (send(sockfd, message, 9, MSG_NOSIGNAL) != 9) {
+            perror("Failed to send inserts");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int send_query_frame(int sockfd, int32_t mintime, int32_t maxtime) {
+    char message[9];
+    pack_frame(message, 'Q', mintime, maxtime);
+    return send(sockfd, message, 9, MSG_NOSIGNAL) == 9 ? 0 : -1;
+}
+
+// Returns: 1 and the answer in *result, 0 if the server closed the connection, -1 on timeout or error
+int recv_answer(int sockfd, int32_t *result) {
+    int32_t response;
+    ssize_t n = recv(sockfd, &response, 4, MSG_WAITALL);
+    if (n == 0) {
+        return 0;
+    }
+    if (n != 4) {
+        return -1;
+    }
+    *result = ntohl(response);
+    return 1;
+}
+
+int32_t query(int sockfd, int32_t mintime, int32_t maxtime) {
+    int32_t result;
+    if (send_query_frame(sockfd, mintime, maxtime) < 0 || recv_answer(sockfd, &result) != 1) {
+        perror("Query failed");
+        return -1;
+    }
+    return result;
+}
+
+int check(const char *what, int32_t got, int32_t expected) {
+    printf("%s: %d (expected %d)\n", what, got, expected);
+    return got != expected;
+}
+
+// -k: an idle session's array is shrunk to fit; its answers and later inserts must not change
+int test_shrink(void) {
+    int failures = 0;
+    printf("\n=== Shrink after -k %d ===\n", SHRINK_AFTER_S);
+    int sockfd = connect_server();
+    if (sockfd < 0) {
+        return 1;
+    }
+    set_timeout(sockfd, 2000);
+    send_inserts(sockfd, 1, 150);                   // 150 prices in a 200-slot array
+    int32_t all = query(sockfd, 1, 150);
+    int32_t part = query(sockfd, 40, 60);
+    usleep((SHRINK_AFTER_S * 1000 + 500) * 1000);  // Past the shrink deadline, short of the idle timeout
+    failures += check("Full range after shrink", query(sockfd, 1, 150), all);
+    failures += check("Sub range after shrink", query(sockfd, 40, 60), part);
+    send_inserts(sockfd, 151, 300);                 // Growing again from the shrunk capacity
+    failures += check("Full range after regrowing", query(sockfd, 1, 300), 150);
+    failures += check("Newest price", query(sockfd, 300, 300), 300);
+    close(sockfd);
+    return failures;
+}
+
+// -M: an insert that does not fit stalls its session until memory is released, and is never lost;
+// new connections are refused while the budget is full
+int test_budget(void) {
+    int failures = 0;
+    printf("\n=== Memory budget -M %d ===\n", BUDGET_BYTES >> 20);
+
+    int holder = connect_server();                  // Takes 1.6 MB: 204800 prices fill their array exactly
+    int producer = connect_server();
+    if (holder < 0 || producer < 0) {
+        return 1;
+    }
+    set_timeout(holder, SYNC_TIMEOUT_MS);
+    send_inserts(holder, 1, 204800);
+    failures += check("Holder synced", query(holder, 204800, 204800), 204800);
+
+    // Producer fits 51200 prices (0.4 MB), the array doubling past that exceeds the budget
+    set_timeout(producer, 500);
+    send_inserts(producer, 1, 60000);
+    send_query_frame(producer, 1, 60000);
+    int32_t result;
+    int state = recv_answer(producer, &result);
+    printf("Producer over budget: %s (expected stalled)\n",
+           state < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? "stalled" : "answered or closed");
+    failures += !(state < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+
+    // The remaining 48 KB admits a few dozen empty sessions, then connections are refused
+    int fillers[MAX_FILLERS];
+    int opened = 0;
+    int refused = 0;
+    while (opened < MAX_FILLERS && !refused) {
+        int sockfd = connect_server();
+        if (sockfd < 0) {
+            break;
+        }
+        set_timeout(sockfd, 1000);
+        if (send_query_frame(sockfd, 1, 1) < 0 || recv_answer(sockfd, &result) != 1) {
+            refused = 1;                            // Accepted and closed at once
+            close(sockfd);
+        }
+        else {
+            fillers[opened++] = sockfd;
+        }
+    }
+    printf("Connections refused after %d accepted: %s (expected yes)\n", opened, refused ? "yes" : "no");
+    failures += !refused;
+
+    close(holder);                                  // Frees the holder's array - the producer resumes
+    set_timeout(producer, SYNC_TIMEOUT_MS);
+    state = recv_answer(producer, &result);
+    failures += check("Producer after release", state == 1 ? result : -1, 30000);
+    failures += check("First parked price", query(producer, 51201, 51201), 51201);
+    failures += check("Last price", query(producer, 60000, 60000), 60000);
+    for (int i = 0; i < opened; ++i) {
+        close(fillers[i]);
+    }
+    close(producer);
+    return failures;
+}
+
+// -M last resort: a lone session over budget cannot be unblocked by anyone, so its excess inserts are dropped
+int test_last_resort(void) {
+    int failures = 0;
+    printf("\n=== Lone session over budget ===\n");
+    usleep(200 * 1000);                             // Let the server see the previous test's closes
+    int sockfd = connect_server();
+    if (sockfd < 0) {
+        return 1;
+    }
+    set_timeout(sockfd, SYNC_TIMEOUT_MS);
+    send_inserts(sockfd, 1, 210000);                // Only 204800 fit: the next doubling exceeds the budget
+    failures += check("Kept prices", query(sockfd, 204800, 204800), 204800);
+    failures += check("Dropped prices", query(sockfd, 204801, 210000), 0);
+    close(sockfd);
+    return failures;
+}
+
+// -i: a session that sends nothing is closed by the server
+int test_idle(void) {
+    printf("\n=== Idle timeout -i %d ===\n", IDLE_TIMEOUT_S);
+    int sockfd = connect_server();
+    if (sockfd < 0) {
+        return 1;
+    }
+    set_timeout(sockfd, IDLE_TIMEOUT_S * 500);
+    int32_t result;
+    int state = recv_answer(sockfd, &result);       // Nothing sent, so nothing but EOF may arrive
+    printf("Before the timeout: %s (expected open)\n", state < 0 ? "open" : "closed");
+    int failures = state >= 0;
+    set_timeout(sockfd, (IDLE_TIMEOUT_S + 1) * 1000);
+    state = recv_answer(sockfd, &result);
+    printf("After the timeout: %s (expected closed)\n", state == 0 ? "closed" : "open");
+    failures += state != 0;
+    close(sockfd);
+    return failures;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        printf("Usage: %s <server_ip> <port>\n", argv[0]);
+        printf("Start the server with: ./price_server <port> -i %d -k %d -M %d\n",
+               IDLE_TIMEOUT_S, SHRINK_AFTER_S, BUDGET_BYTES >> 20);
+        return 1;
+    }
+    g_ip = argv[1];
+    g_port = atoi(argv[2]);
+
+    int failures = 0;
+    failures += test_shrink();
+    failures += test_budget();
+    failures += test_last_resort();
+    failures += test_idle();
+
+    printf("\n=== Limits tests completed: %d failure(s) ===\n", failures);
+    return failures ? 1 : 0;
+}
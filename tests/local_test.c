@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <time.h>
+#include "../include/shm_ring.h"
+
+#define LATENCY_QUERIES 10000  // Timed round trips per transport
+
+// Minimal transport interface so the same checks run over AF_UNIX and shared memory
+typedef struct {
+    int sockfd;             // AF_UNIX client socket, or the shm control connection
+    shm_region_t *ring;     // NULL for the AF_UNIX transport
+    int req_bell;
+    int resp_bell;
+} local_conn_t;
+
+long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+int connect_unix(const char *path) {
+    int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        return -1;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (connect(sockfd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+// Connect to the shm handshake socket and map the ring region the server hands back
+int connect_shm(const char *path, local_conn_t *conn) {
+    conn->sockfd = connect_unix(path);
+    if (conn->sockfd < 0) {
+        return -1;
+    }
+    char byte;
+    int fds[3];
+    char control_buf[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = {&byte, 1};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control_buf;
+    msg.msg_controllen = sizeof(control_buf);
+    if (recvmsg(conn->sockfd, &msg, 0) != 1) {
+        return -1;
+    }
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+        return -1;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    conn->ring = mmap(NULL, sizeof(shm_region_t), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    if (conn->ring == MAP_FAILED) {
+        conn->ring = NULL;
+        return -1;
+    }
+    conn->req_bell = fds[1];
+    conn->resp_bell = fds[2];
+    return 0;
+}
+
+void close_conn(local_conn_t *conn) {
+    if (conn->ring) {
+        munmap(conn->ring, sizeof(shm_region_t));
+        close(conn->req_bell);
+        close(conn->resp_bell);
+    }
+    close(conn->sockfd);
+}
+
+int send_frame(local_conn_t *conn, char type, int32_t first, int32_t second) {
+    char message[9];
+    message[0] = type;
+    *(int32_t*)(message + 1) = htonl(first);
+    *(int32_t*)(message + 5) = htonl(second);
+
+    if (!conn->ring) {
+        return send(conn->sockfd, message, 9, 0) == 9 ? 0 : -1;
+    }
+    shm_ring_index_t *idx = &conn->ring->req;
+    uint32_t head = atomic_load_explicit(&idx->head, memory_order_relaxed);
+    while (head - atomic_load_explicit(&idx->tail, memory_order_acquire) >= SHM_RING_SLOTS) {
+        ;   // Ring full - wait for the server to catch up
+    }
+    memcpy(conn->ring->req_slots[head & SHM_RING_MASK], message, 9);
+    atomic_store_explicit(&idx->head, head + 1, memory_order_release);
+    uint64_t one = 1;
+    return write(conn->req_bell, &one, sizeof(one)) == sizeof(one) ? 0 : -1;
+}
+
+int recv_response(local_conn_t *conn, int32_t *result) {
+    int32_t response;
+    if (!conn->ring) {
+        if (recv(conn->sockfd, &response, 4, MSG_WAITALL) != 4) {
+            return -1;
+        }
+        *result = ntohl(response);
+        return 0;
+    }
+    shm_ring_index_t *idx = &conn->ring->resp;
+    uint32_t tail = atomic_load_explicit(&idx->tail, memory_order_relaxed);
+    int spins = 0;
+    while (atomic_load_explicit(&idx->head, memory_order_acquire) == tail) {
+        if (++spins > 1000) {
+            uint64_t count;     // Block on the doorbell once spinning stops paying off
+            if (read(conn->resp_bell, &count, sizeof(count)) != sizeof(count)) {
+                return -1;
+            }
+        }
+    }
+    response = conn->ring->resp_slots[tail & SHM_RING_MASK];
+    atomic_store_explicit(&idx->tail, tail + 1, memory_order_release);
+    *result = ntohl(response);
+    return 0;
+}
+
+int32_t send_query(local_conn_t *conn, int32_t mintime, int32_t maxtime) {
+    int32_t result;
+    if (send_frame(conn, 'Q', mintime, maxtime) < 0 || recv_response(conn, &result) < 0) {
+        perror("Query failed");
+        return -1;
+    }
+    return result;
+}
+
+// Task.txt example session plus a few edge cases, then a latency run
+int run_checks(const char *name, local_conn_t *conn) {
+    int failures = 0;
+    printf("\n=== %s transport ===\n", name);
+
+    send_frame(conn, 'I', 12345, 101);
+    send_frame(conn, 'I', 12346, 102);
+    send_frame(conn, 'I', 12347, 100);
+    send_frame(conn, 'I', 40960, 5);
+    int32_t result = send_query(conn, 12288, 16384);
+    printf("Task.txt example: %d (expected 101)\n", result);
+    failures += result != 101;
+    result = send_query(conn, 16384, 12288);
+    printf("Inverted range: %d (expected 0)\n", result);
+    failures += result != 0;
+    result = send_query(conn, 50000, 60000);
+    printf("Empty range: %d (expected 0)\n", result);
+    failures += result != 0;
+
+    uint32_t *samples = malloc(LATENCY_QUERIES * sizeof(uint32_t));
+    if (!samples) {
+        return failures + 1;
+    }
+    int count = 0;
+    while (count < LATENCY_QUERIES) {
+        long long start = now_ns();
+        if (send_query(conn, 12288, 16384) != 101) {
+            failures++;
+            break;
+        }
+        samples[count++] = (uint32_t)(now_ns() - start);
+    }
+    if (count > 0) {
+        qsort(samples, count, sizeof(uint32_t), compare_u32);
+        printf("Round trip over %d queries: p50 = %.1f us, p99 = %.1f us\n", count,
+               samples[count / 2] / 1000.0, samples[count * 99 / 100] / 1000.0);
+    }
+    free(samples);
+    return failures;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        printf("Usage: %s <unix_socket_path> <shm_socket_path>\n", argv[0]);
+        printf("Start the server with: ./price_server <port> -u <unix_socket_path> -m <shm_socket_path>\n");
+        return 1;
+    }
+    int failures = 0;
+
+    local_conn_t unix_conn;
+    memset(&unix_conn, 0, sizeof(unix_conn));
+    unix_conn.sockfd = connect_unix(argv[1]);
+    if (unix_conn.sockfd < 0) {
+        perror("AF_UNIX connection failed");
+        failures++;
+    } else {
+        failures += run_checks("AF_UNIX", &unix_conn);
+        close_conn(&unix_conn);
+    }
+
+    local_conn_t shm_conn;
+    memset(&shm_conn, 0, sizeof(shm_conn));
+    if (connect_shm(argv[2], &shm_conn) < 0) {
+        perror("Shared-memory handshake failed");
+        failures++;
+    } else {
+        failures += run_checks("Shared-memory ring", &shm_conn);
+        close_conn(&shm_conn);
+    }
+
+    printf("\n=== Local transport tests completed: %d failure(s) ===\n", failures);
+    return failures ? 1 : 0;
+}
@@ -39,6 +39,10 @@ void send_invalid_messages(int sockfd) {
     // Too long message
     char too_long[15] = {'I', 0x00, 0x00, 0x30, 0x39, 0x00, 0x00, 0x00, 0x65, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
     send_raw_bytes(sockfd, too_long, 15, "Too long message (15 bytes)");
+
+    // The server cuts the stream into 9-byte frames, so the 6 extra bytes start a frame - finish it
+    char padding[3] = {0x00, 0x00, 0x00};
+    send_raw_bytes(sockfd, padding, 3, "Padding (3 bytes) completing the frame the extra bytes started");
     
     // Non-printable message type
     char non_printable[9] = {0xFF, 0x00, 0x00, 0x30, 0x39, 0x00, 0x00, 0x00, 0x65};
@@ -0,0 +1,571 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <time.h>
+
+// Capture format written by ./price_server -r <file> (see include/server.h)
+#define CAPTURE_MAGIC   "PRICECAP"
+#define CAPTURE_RECORD  21
+#define CAPTURE_END_FLAG (1ULL << 63)  // Set in the time field of the record the server writes when a session closes
+#define MAX_WORKERS     64
+#define DRAIN_TIMEOUT_MS 5000  // How long to wait for outstanding answers before counting them as errors
+
+typedef struct {
+    uint32_t session;       // Session id from the capture
+    uint64_t time_us;       // Microseconds since the capture started
+    int end;                // Session closed here (the frame is not a message)
+    char frame[9];          // Raw 9-byte message
+} record_t;
+
+typedef struct {
+    int32_t timestamp;
+    int32_t price;
+} price_entry_t;
+
+// A query that was sent and whose answer has not arrived yet
+typedef struct {
+    int32_t expected;       // Answer computed from the local model at send time
+    int32_t mintime;
+    int32_t maxtime;
+    long long sent_at;
+} pending_query_t;
+
+// Local model of one server session, used to compute the expected query answers
+typedef struct {
+    int sockfd;             // -1 until the first frame is sent, -2 after a failure, -3 once closed
+    uint32_t capture_id;    // Session id in the capture, for error messages
+    price_entry_t *prices;
+    size_t count;
+    size_t capacity;
+    pending_query_t *pending;   // FIFO of outstanding queries (answers come back in send order)
+    size_t pending_head;
+    size_t pending_count;
+    size_t pending_capacity;
+    unsigned char partial[4];   // Bytes of an answer split across reads
+    int partial_len;
+} replay_session_t;
+
+// Summary each worker sends back to the parent, followed by `queries` latency samples
+typedef struct {
+    long long frames;
+    long long queries;
+    long long mismatches;
+    long long errors;
+    long long elapsed_ns;
+} worker_stats_t;
+
+record_t *records;
+size_t num_records;
+uint32_t *session_ids;      // Sorted distinct session ids
+size_t num_sessions;
+
+long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+int load_capture(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror("Failed to open capture file");
+        return -1;
+    }
+    char magic[8];
+    if (fread(magic, 8, 1, file) != 1 || memcmp(magic, CAPTURE_MAGIC, 8) != 0) {
+        printf("Not a price server capture file: %s\n", path);
+        fclose(file);
+        return -1;
+    }
+    size_t capacity = 1024;
+    records = malloc(capacity * sizeof(record_t));
+    unsigned char raw[CAPTURE_RECORD];
+    while (records && fread(raw, CAPTURE_RECORD, 1, file) == 1) {
+        if (num_records == capacity) {
+            capacity *= 2;
+            record_t *grown = realloc(records, capacity * sizeof(record_t));
+            if (!grown) {
+                free(records);
+                records = NULL;
+                break;
+            }
+            records = grown;
+        }
+        record_t *rec = &records[num_records++];
+        uint32_t id;
+        memcpy(&id, raw, 4);
+        rec->session = ntohl(id);
+        rec->time_us = 0;
+        for (int i = 0; i < 8; i++) {
+            rec->time_us = (rec->time_us << 8) | raw[4 + i];
+        }
+        rec->end = (rec->time_us & CAPTURE_END_FLAG) != 0;
+        rec->time_us &= ~CAPTURE_END_FLAG;
+        memcpy(rec->frame, raw + 12, 9);
+    }
+    fclose(file);
+    if (!records) {
+        printf("Out of memory while loading capture\n");
+        return -1;
+    }
+
+    // Distinct session ids, sorted so records can be mapped to sessions with bsearch()
+    session_ids = malloc((num_records ? num_records : 1) * sizeof(uint32_t));
+    if (!session_ids) {
+        printf("Out of memory while loading capture\n");
+        return -1;
+    }
+    for (size_t i = 0; i < num_records; i++) {
+        session_ids[i] = records[i].session;
+    }
+    qsort(session_ids, num_records, sizeof(uint32_t), compare_u32);
+    for (size_t i = 0; i < num_records; i++) {
+        if (num_sessions == 0 || session_ids[num_sessions - 1] != session_ids[i]) {
+            session_ids[num_sessions++] = session_ids[i];
+        }
+    }
+    return 0;
+}
+
+size_t session_index(uint32_t id) {
+    uint32_t *found = bsearch(&id, session_ids, num_sessions, sizeof(uint32_t), compare_u32);
+    return found - session_ids;
+}
+
+int connect_to_server(const char *server_ip, int port) {
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        return -1;
+    }
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    inet_pton(AF_INET, server_ip, &server_addr.sin_addr);
+    if (connect(sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        close(sockfd);
+        return -1;
+    }
+    // Send every frame immediately - Nagle would hold inserts back and skew the latencies
+    int nodelay = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    return sockfd;
+}
+
+// Same semantics as the server: keep prices sorted by timestamp
+void model_insert(replay_session_t *session, int32_t timestamp, int32_t price) {
+    if (session->count == session->capacity) {
+        size_t capacity = session->capacity ? session->capacity * 2 : 100;
+        price_entry_t *grown = realloc(session->prices, capacity * sizeof(price_entry_t));
+        if (!grown) {
+            return;
+        }
+        session->prices = grown;
+        session->capacity = capacity;
+    }
+    size_t i;
+    for (i = session->count; i > 0 && session->prices[i - 1].timestamp > timestamp; i--) {
+        session->prices[i] = session->prices[i - 1];
+    }
+    session->prices[i].timestamp = timestamp;
+    session->prices[i].price = price;
+    session->count++;
+}
+
+int32_t model_query(replay_session_t *session, int32_t mintime, int32_t maxtime) {
+    long long sum = 0;
+    int count = 0;
+    if (mintime > maxtime) {
+        return 0;
+    }
+    for (size_t i = 0; i < session->count; i++) {
+        if (session->prices[i].timestamp >= mintime && session->prices[i].timestamp <= maxtime) {
+            sum += session->prices[i].price;
+            count++;
+        }
+    }
+    return count ? (int32_t)(sum / count) : 0;
+}
+
+// Per-worker replay state (each worker is its own process)
+replay_session_t *sessions;
+size_t num_logical;
+uint32_t *latencies;
+worker_stats_t stats;
+int worker_id;
+size_t total_pending;       // Outstanding queries across all of this worker's sessions
+struct pollfd *poll_fds;    // Scratch arrays for collect_answers(), sized num_logical
+size_t *poll_owners;
+
+void push_pending(replay_session_t *session, pending_query_t query) {
+    if (session->pending_count == session->pending_capacity) {
+        size_t capacity = session->pending_capacity ? session->pending_capacity * 2 : 16;
+        pending_query_t *grown = malloc(capacity * sizeof(pending_query_t));
+        if (!grown) {
+            printf("Worker %d: out of memory\n", worker_id);
+            exit(1);
+        }
+        // Unroll the circular buffer into the new array
+        for (size_t i = 0; i < session->pending_count; i++) {
+            grown[i] = session->pending[(session->pending_head + i) % session->pending_capacity];
+        }
+        free(session->pending);
+        session->pending = grown;
+        session->pending_head = 0;
+        session->pending_capacity = capacity;
+    }
+    session->pending[(session->pending_head + session->pending_count) % session->pending_capacity] = query;
+    session->pending_count++;
+    total_pending++;
+}
+
+// Stop using a session: its outstanding queries will never be answered
+void fail_session(replay_session_t *session) {
+    stats.errors += session->pending_count;
+    total_pending -= session->pending_count;
+    session->pending_count = 0;
+    if (session->sockfd >= 0) {
+        close(session->sockfd);
+    }
+    session->sockfd = -2;
+}
+
+// Match one 4-byte answer against the oldest outstanding query of the session
+void check_answer(replay_session_t *session, int32_t answer, long long now) {
+    if (session->pending_count == 0) {
+        printf("Worker %d: session %u sent an unexpected answer %d\n", worker_id, session->capture_id, answer);
+        stats.errors++;
+        return;
+    }
+    pending_query_t *query = &session->pending[session->pending_head];
+    session->pending_head = (session->pending_head + 1) % session->pending_capacity;
+    session->pending_count--;
+    total_pending--;
+    long long elapsed = now - query->sent_at;
+    latencies[stats.queries++] = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+    if (answer != query->expected) {
+        if (stats.mismatches < 5) {
+            printf("Worker %d: session %u query [%d, %d] returned %d, expected %d\n",
+                   worker_id, session->capture_id, query->mintime, query->maxtime, answer, query->expected);
+        }
+        stats.mismatches++;
+    }
+}
+
+// Read whatever answers are available on one socket without blocking
+void read_answers(replay_session_t *session) {
+    unsigned char buf[4096];
+    ssize_t n = recv(session->sockfd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        fail_session(session);
+        return;
+    }
+    long long now = now_ns();
+    for (ssize_t i = 0; i < n; i++) {
+        session->partial[session->partial_len++] = buf[i];
+        if (session->partial_len == 4) {
+            int32_t answer;
+            memcpy(&answer, session->partial, 4);
+            session->partial_len = 0;
+            check_answer(session, (int32_t)ntohl(answer), now);
+        }
+    }
+}
+
+/*
+ * Wait up to timeout_ms for answers on every socket with outstanding queries and collect them.
+ * Returns early as soon as something was read.
+ */
+void collect_answers(int timeout_ms) {
+    if (total_pending == 0) {
+        if (timeout_ms > 0) {
+            usleep(timeout_ms * 1000);
+        }
+        return;
+    }
+    struct pollfd *fds = poll_fds;
+    size_t *owners = poll_owners;
+    size_t nfds = 0;
+    for (size_t i = 0; i < num_logical; i++) {
+        if (sessions[i].sockfd >= 0 && sessions[i].pending_count > 0) {
+            fds[nfds].fd = sessions[i].sockfd;
+            fds[nfds].events = POLLIN;
+            owners[nfds++] = i;
+        }
+    }
+    if (poll(fds, nfds, timeout_ms) > 0) {
+        for (size_t i = 0; i < nfds; i++) {
+            if (fds[i].revents) {
+                read_answers(&sessions[owners[i]]);
+            }
+        }
+    }
+}
+
+// Wait until the given session (or, with NULL, every session) has no outstanding queries
+void drain_answers(replay_session_t *session) {
+    long long deadline = now_ns() + DRAIN_TIMEOUT_MS * 1000000LL;
+    while ((session ? session->pending_count : total_pending) > 0 && now_ns() < deadline) {
+        collect_answers(10);
+    }
+    if (session && session->pending_count > 0) {
+        fail_session(session);
+    }
+    for (size_t i = 0; !session && i < num_logical; i++) {
+        if (sessions[i].pending_count > 0) {
+            fail_session(&sessions[i]);
+        }
+    }
+}
+
+// Send one frame without blocking the whole worker: collect answers while the socket is full
+int send_frame(replay_session_t *session, const char *frame) {
+    size_t sent = 0;
+    while (sent < 9) {
+        ssize_t n = send(session->sockfd, frame + sent, 9 - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            collect_answers(10);    // The server may be waiting for us to read before it reads more
+            if (session->sockfd < 0) {
+                return -1;
+            }
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Replay every logical session assigned to this worker (logical = capture session x copy).
+ * Frames are sent in capture order without waiting for answers, so pipelined queries and
+ * concurrent sessions stay pipelined and concurrent. Answers are collected with poll() in between
+ * and matched against a per-session FIFO of outstanding queries.
+ */
+void worker(int id, int num_workers, int copies, int fast, const char *server_ip, int port, int report_fd) {
+    worker_id = id;
+    num_logical = num_sessions * copies;
+    sessions = calloc(num_logical, sizeof(replay_session_t));
+    latencies = malloc(num_records * copies * sizeof(uint32_t) + 1);
+    poll_fds = malloc(num_logical * sizeof(struct pollfd) + 1);
+    poll_owners = malloc(num_logical * sizeof(size_t) + 1);
+    memset(&stats, 0, sizeof(stats));
+    if (!sessions || !latencies || !poll_fds || !poll_owners) {
+        printf("Worker %d: out of memory\n", worker_id);
+        exit(1);
+    }
+    for (size_t i = 0; i < num_logical; i++) {
+        sessions[i].sockfd = -1;
+        sessions[i].capture_id = session_ids[i / copies];
+    }
+
+    long long start = now_ns();
+    for (size_t r = 0; r < num_records; r++) {
+        record_t *rec = &records[r];
+        if (!fast) {
+            // Recorded pace: collect answers until this frame's offset from the start of the capture
+            long long wait_ns;
+            while ((wait_ns = (long long)rec->time_us * 1000 - (now_ns() - start)) > 0) {
+                long long wait_ms = wait_ns / 1000000;
+                if (wait_ms > 0) {
+                    collect_answers(wait_ms > 100 ? 100 : wait_ms);
+                } else {
+                    usleep(wait_ns / 1000);
+                }
+            }
+        }
+        size_t base = session_index(rec->session);
+        for (int copy = 0; copy < copies; copy++) {
+            size_t logical = base * copies + copy;
+            if ((int)(logical % num_workers) != worker_id) {
+                continue;
+            }
+            replay_session_t *session = &sessions[logical];
+            if (rec->end) {
+                // Session closed in the capture: close it here too, so fds are reused like on the server
+                if (session->sockfd >= 0) {
+                    drain_answers(session);
+                }
+                if (session->sockfd >= 0) {
+                    close(session->sockfd);
+                }
+                session->sockfd = -3;
+                continue;
+            }
+            if (session->sockfd == -1) {
+                session->sockfd = connect_to_server(server_ip, port);
+                if (session->sockfd < 0) {
+                    session->sockfd = -2;   // Do not retry a session that failed to connect
+                }
+            }
+            if (session->sockfd < 0) {
+                stats.errors++;             // Failed or already closed session: this frame is not replayed
+                continue;
+            }
+
+            int32_t first = ntohl(*(int32_t*)(rec->frame + 1));
+            int32_t second = ntohl(*(int32_t*)(rec->frame + 5));
+            long long sent_at = now_ns();
+            if (send_frame(session, rec->frame) < 0) {
+                stats.errors++;
+                fail_session(session);
+                continue;
+            }
+            stats.frames++;
+            if (rec->frame[0] == 'I') {
+                model_insert(session, first, second);
+            } else if (rec->frame[0] == 'Q') {
+                pending_query_t query = {model_query(session, first, second), first, second, sent_at};
+                push_pending(session, query);
+            }
+        }
+        if (total_pending > 0) {
+            collect_answers(0);     // Pick up answers that are already there to keep latencies honest
+        }
+    }
+    drain_answers(NULL);
+    stats.elapsed_ns = now_ns() - start;
+
+    for (size_t i = 0; i < num_logical; i++) {
+        if (sessions[i].sockfd >= 0) {
+            close(sessions[i].sockfd);
+        }
+        free(sessions[i].prices);
+        free(sessions[i].pending);
+    }
+    if (write(report_fd, &stats, sizeof(stats)) != sizeof(stats) ||
+        write(report_fd, latencies, stats.queries * sizeof(uint32_t)) != (ssize_t)(stats.queries * sizeof(uint32_t))) {
+        perror("Failed to report worker results");
+    }
+    free(sessions);
+    free(latencies);
+    free(poll_fds);
+    free(poll_owners);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 4) {
+        printf("Usage: %s <server_ip> <port> <capture_file> [-f] [-w workers] [-n copies]\n", argv[0]);
+        printf("  -f          replay as fast as possible instead of at recorded pace\n");
+        printf("  -w workers  spread sessions across this many client processes (default 1)\n");
+        printf("  -n copies   replay every captured session this many times on separate connections (default 1)\n");
+        return 1;
+    }
+    const char *server_ip = argv[1];
+    int port = atoi(argv[2]);
+    int fast = 0;
+    int num_workers = 1;
+    int copies = 1;
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0) {
+            fast = 1;
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            num_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            copies = atoi(argv[++i]);
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (num_workers < 1 || num_workers > MAX_WORKERS || copies < 1) {
+        printf("Workers must be 1-%d and copies at least 1\n", MAX_WORKERS);
+        return 1;
+    }
+    if (load_capture(argv[3]) != 0) {
+        return 1;
+    }
+
+    printf("=== TRAFFIC REPLAY ===\n");
+    printf("Capture: %zu frames in %zu sessions\n", num_records, num_sessions);
+    printf("Replaying %zu connections across %d workers (%s)\n\n",
+           num_sessions * copies, num_workers, fast ? "max speed" : "recorded pace");
+
+    fflush(stdout);     // Do not let the children inherit (and print) buffered output
+
+    // One pipe per worker so results from different workers never interleave
+    int pipes[MAX_WORKERS][2];
+    for (int i = 0; i < num_workers; i++) {
+        if (pipe(pipes[i]) < 0) {
+            perror("Pipe failed");
+            return 1;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(pipes[i][0]);
+            worker(i, num_workers, copies, fast, server_ip, port, pipes[i][1]);
+            exit(0);
+        } else if (pid < 0) {
+            perror("Fork failed");
+            return 1;
+        }
+        close(pipes[i][1]);
+    }
+
+    worker_stats_t total;
+    memset(&total, 0, sizeof(total));
+    uint32_t *latencies = malloc(num_records * copies * sizeof(uint32_t) + 1);
+    size_t num_latencies = 0;
+    for (int i = 0; i < num_workers; i++) {
+        worker_stats_t stats;
+        if (read(pipes[i][0], &stats, sizeof(stats)) != sizeof(stats)) {
+            printf("Worker %d: no results\n", i);
+            total.errors++;
+            close(pipes[i][0]);
+            continue;
+        }
+        size_t want = stats.queries * sizeof(uint32_t);
+        size_t got = 0;
+        ssize_t n;
+        while (latencies && got < want && (n = read(pipes[i][0], (char*)(latencies + num_latencies) + got, want - got)) > 0) {
+            got += n;
+        }
+        num_latencies += got / sizeof(uint32_t);
+        close(pipes[i][0]);
+        total.frames += stats.frames;
+        total.queries += stats.queries;
+        total.mismatches += stats.mismatches;
+        total.errors += stats.errors;
+        if (stats.elapsed_ns > total.elapsed_ns) {
+            total.elapsed_ns = stats.elapsed_ns;
+        }
+    }
+    for (int i = 0; i < num_workers; i++) {
+        int status;
+        wait(&status);
+    }
+
+    printf("=== REPLAY COMPLETED ===\n");
+    double seconds = total.elapsed_ns / 1e9;
+    printf("Frames sent: %lld in %.3f s (%.0f frames/s)\n", total.frames, seconds, seconds > 0 ? total.frames / seconds : 0.0);
+    printf("Queries: %lld, mismatched responses: %lld, errors: %lld\n", total.queries, total.mismatches, total.errors);
+    if (num_latencies > 0) {
+        qsort(latencies, num_latencies, sizeof(uint32_t), compare_u32);
+        printf("Query latency: p50 = %.1f us, p99 = %.1f us, p99.9 = %.1f us, max = %.1f us\n",
+               latencies[num_latencies / 2] / 1000.0,
+               latencies[num_latencies * 99 / 100] / 1000.0,
+               latencies[num_latencies * 999 / 1000] / 1000.0,
+               latencies[num_latencies - 1] / 1000.0);
+    }
+    free(latencies);
+    free(records);
+    free(session_ids);
+    return (total.mismatches || total.errors) ? 1 : 0;
+}
@@ -7,6 +7,23 @@
 #include <sys/socket.h>
 #include <sys/wait.h>
 #include <time.h>
+#include <limits.h>
+#include <stdint.h>
+
+#define LATENCY_QUERIES 1000  // Timed queries per client for the latency report
+
+// Monotonic clock in nanoseconds
+long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
 
 void send_insert(int sockfd, int32_t timestamp, int32_t price) {
     char message[9];
@@ -39,7 +56,7 @@ int32_t send_query(int sockfd, int32_t mintime, int32_t maxtime) {
     return ntohl(response);
 }
 
-void client_worker(int client_id, const char* server_ip, int port) {
+void client_worker(int client_id, const char* server_ip, int port, int latency_fd) {
     printf("Client %d: Starting...\n", client_id);
     
     int sockfd = socket(AF_INET, SOCK_STREAM, 0);
@@ -82,6 +99,27 @@ void client_worker(int client_id, const char* server_ip, int port) {
     int32_t cross_result = send_query(sockfd, other_base, other_base + 49);
     printf("Client %d: Cross-client query result: %d (should be 0)\n", client_id, cross_result);
     
+    // Timed query round trips, sent back to the parent for the latency report
+    uint32_t samples[LATENCY_QUERIES];
+    int num_samples = 0;
+    for (int i = 0; i < LATENCY_QUERIES; i++) {
+        long long start = now_ns();
+        if (send_query(sockfd, base_time, base_time + 49) < 0) {
+            break;
+        }
+        long long elapsed = now_ns() - start;
+        samples[num_samples++] = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+    }
+    // Write in chunks of at most PIPE_BUF bytes so samples from different clients never interleave mid-value
+    size_t total = num_samples * sizeof(uint32_t);
+    for (size_t off = 0; off < total; off += PIPE_BUF) {
+        size_t chunk = total - off < PIPE_BUF ? total - off : PIPE_BUF;
+        if (write(latency_fd, (char*)samples + off, chunk) != (ssize_t)chunk) {
+            perror("Failed to report latency samples");
+            break;
+        }
+    }
+    
     printf("Client %d: Finished\n", client_id);
     close(sockfd);
 }
@@ -102,13 +140,21 @@ int main(int argc, char *argv[]) {
     
     time_t start_time = time(NULL);
     
+    // Children report their query latencies through this pipe
+    int latency_pipe[2];
+    if (pipe(latency_pipe) < 0) {
+        perror("Pipe failed");
+        return 1;
+    }
+    
     // Fork multiple client processes
     for (int i = 0; i < num_clients; i++) {
         pid_t pid = fork();
         
         if (pid == 0) {
             // Child process - run client
-            client_worker(i, server_ip, port);
+            close(latency_pipe[0]);
+            client_worker(i, server_ip, port, latency_pipe[1]);
             exit(0);
         } else if (pid < 0) {
             perror("Fork failed");
@@ -119,8 +165,18 @@ int main(int argc, char *argv[]) {
         usleep(100000); // 100ms
     }
     
-    // Parent process - wait for all children
+    // Parent process - collect latency samples until every child has closed the pipe
     printf("Parent: Waiting for all clients to complete...\n");
+    close(latency_pipe[1]);
+    size_t max_samples = (size_t)num_clients * LATENCY_QUERIES;
+    uint32_t *latencies = malloc(max_samples * sizeof(uint32_t));
+    size_t received = 0;
+    ssize_t n;
+    while (latencies && received < max_samples * sizeof(uint32_t) &&
+           (n = read(latency_pipe[0], (char*)latencies + received, max_samples * sizeof(uint32_t) - received)) > 0) {
+        received += n;
+    }
+    close(latency_pipe[0]);
     for (int i = 0; i < num_clients; i++) {
         int status;
         wait(&status);
@@ -129,6 +185,19 @@ int main(int argc, char *argv[]) {
     time_t end_time = time(NULL);
     printf("\n=== STRESS TEST COMPLETED ===\n");
     printf("All %d clients finished in %ld seconds\n", num_clients, end_time - start_time);
+    
+    // Latency report: compare runs with and without the server's low-latency flags
+    size_t count = received / sizeof(uint32_t);
+    if (count > 0) {
+        qsort(latencies, count, sizeof(uint32_t), compare_u32);
+        printf("Query latency over %zu round trips: p50 = %.1f us, p99 = %.1f us, p99.9 = %.1f us, max = %.1f us\n",
+               count,
+               latencies[count / 2] / 1000.0,
+               latencies[count * 99 / 100] / 1000.0,
+               latencies[count * 999 / 1000] / 1000.0,
+               latencies[count - 1] / 1000.0);
+    }
+    free(latencies);
     printf("If your server handled this without crashes or memory leaks, it's robust!\n");
     
     return 0;